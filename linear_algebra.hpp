@@ -1,5 +1,17 @@
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace linear_algebra {
 
@@ -37,6 +49,31 @@ namespace linear_algebra {
             return static_cast<expr_type const&>(*this)(row, col);
         }
 
+        /*
+        * Returns the half-open range of columns that may hold non-zero
+        * entries in row (of rows that may in col). Structured matrices narrow
+        * these ranges so that products skip their known zeros.
+        */
+        std::pair<size_t, size_t> nonzero_cols(size_t row) const {
+            return static_cast<expr_type const&>(*this).nonzero_cols_(row);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows(size_t col) const {
+            return static_cast<expr_type const&>(*this).nonzero_rows_(col);
+        }
+
+        /*
+        * Default structure: every entry may be non-zero. Derived classes
+        * hide these to describe their structure.
+        */
+        std::pair<size_t, size_t> nonzero_cols_(size_t) const {
+            return std::make_pair(size_t(0), cols_);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t) const {
+            return std::make_pair(size_t(0), rows_);
+        }
+
         friend std::ostream& operator << (std::ostream& stream, const MatrixExpression<value_type, expr_type> & expr)  {
             if (expr.size() > 0) {
                 for (size_t i = 0; i < expr.rows(); ++i) {
@@ -54,6 +91,148 @@ namespace linear_algebra {
         size_t cols_;
     };
 
+    /*
+    * Placement of a matrix's pages across NUMA nodes.
+    *
+    * Pages are placed by the kernel on the node of the thread that first
+    * writes them, so placement is controlled by which pinned thread performs
+    * the first touch.
+    *
+    * local       all pages on the node of the constructing thread. The
+    *             default: no threads are started.
+    * interleaved page-sized runs of rows dealt round-robin to all CPUs.
+    * row_blocks  one contiguous block of rows per CPU, matching the row
+    *             blocks each CPU computes when an expression is evaluated.
+    *
+    * interleaved and row_blocks start one thread per allowed CPU for every
+    * initialization, copy and evaluation of a large matrix, so they only pay
+    * off for long-lived matrices on multi-socket hosts.
+    */
+    enum class Placement { local, interleaved, row_blocks };
+
+    namespace detail {
+
+        /*
+        * Wraps T in a non-deduced context, so that scalar arguments are
+        * converted to the value type of the matrix arguments.
+        */
+        template<typename T>
+        struct identity {
+            typedef T type;
+        };
+
+        /*
+        * True if a scalar of type S may scale a matrix of T: S converts to
+        * T, and a floating-point S is not truncated to an integral T.
+        */
+        template<typename S, typename T>
+        struct is_scalar_for : std::integral_constant<bool,
+            std::is_convertible<S, T>::value &&
+            !(std::is_floating_point<S>::value && std::is_integral<T>::value)> {
+        };
+
+        /*
+        * Matrices with fewer elements than this are initialized and
+        * evaluated on the calling thread.
+        */
+        const size_t parallel_threshold = 1 << 16;
+
+        const size_t page_size = 4096;
+
+        /*
+        * Returns the CPUs the calling thread may run on, in ascending order.
+        *
+        * Under taskset or a cpuset-limited container this is a subset of the
+        * machine's CPUs. Where the affinity mask cannot be read, every CPU
+        * reported by std::thread::hardware_concurrency() is returned.
+        */
+        inline std::vector<size_t> allowed_cpus() {
+            std::vector<size_t> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+                cpus.reserve(CPU_COUNT(&set));
+                for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            if (cpus.empty()) {
+                size_t count = std::max(1u, std::thread::hardware_concurrency());
+                for (size_t cpu = 0; cpu < count; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        /*
+        * Restricts the calling thread to a single CPU.
+        *
+        * Returns false if the thread could not be pinned, including where
+        * thread affinity is not supported.
+        */
+        inline bool pin_current_thread(size_t cpu) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            (void) cpu;
+            return false;
+#endif
+        }
+
+        /*
+        * Splits [0, count) into chunks of grain units, deals the chunks
+        * round-robin to one worker thread per allowed CPU, worker t pinned
+        * to cpus[t], and calls fn(begin, end) for each chunk.
+        *
+        * The partition depends only on count, grain and cpus, so repeated
+        * calls with the same affinity mask hand each unit to the same CPU.
+        * Pinning is best effort: a worker that cannot be pinned still runs
+        * its chunks, on whichever CPU the scheduler picks.
+        */
+        template<typename F>
+        void parallel_for(size_t count, size_t grain, std::vector<size_t> const& cpus, F fn) {
+            size_t chunks = (count + grain - 1) / grain;
+            size_t workers = std::min(cpus.size(), chunks);
+            if (workers <= 1) {
+                fn(0, count);
+                return;
+            }
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < workers; ++t) {
+                size_t cpu = cpus[t];
+                threads.emplace_back([=]() {
+                    pin_current_thread(cpu);
+                    for (size_t chunk = t; chunk < chunks; chunk += workers) {
+                        fn(chunk * grain, std::min(count, (chunk + 1) * grain));
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+    }
+
+    /*
+    * How an expression node holds an operand of type E.
+    *
+    * Expression nodes are a few words in size and are held by value, so a
+    * tree rewritten while it is built owns its subexpressions. Types owning
+    * storage specialize this to be held by reference.
+    */
+    template<typename E>
+    struct operand_traits {
+        typedef E const type;
+    };
+
     /*
     * An NxM Matrix of values of type T.
     *
@@ -74,23 +253,40 @@ namespace linear_algebra {
 
         /*
         * Standard constructor.
+        *
+        * placement the NUMA placement of the matrix's storage.
         */
-        Matrix(size_t rows, size_t cols) {
+        Matrix(size_t rows, size_t cols, Placement placement = Placement::local)
+        : placement_(placement) {
             init(rows, cols);
         }
 
         /*
         * Copy constructor.
+        *
+        * Copies of a matrix in shared-storage mode share its buffer until
+        * one of them is written; otherwise the elements are copied.
         */
-        Matrix(Matrix<value_type> &orig) {
-            copy(orig);
+        Matrix(Matrix<value_type> const& orig) : placement_(orig.placement_) {
+            if (orig.shareable()) {
+                attach(orig);
+            } else {
+                copy(orig);
+                if (orig.shared()) {
+                    share();
+                }
+            }
         }
 
         /*
         * Constucts matrix from and matrix expression, forcing its evaluation.
+        *
+        * placement the NUMA placement of the matrix's storage; rows are
+        * evaluated by the threads that first touch them.
         */
         template<typename E>
-        Matrix(MatrixExpression<value_type, E> const& expr) {
+        Matrix(MatrixExpression<value_type, E> const& expr, Placement placement = Placement::local)
+        : placement_(placement) {
             copy(expr);
         }
 
@@ -115,9 +311,7 @@ namespace linear_algebra {
         * Destructor.
         */
         ~Matrix() {
-            if (data_ != nullptr) {
-                delete[] data_;
-            }
+            release();
         }
 
         /*
@@ -125,17 +319,84 @@ namespace linear_algebra {
         */
         Matrix<value_type>& operator= (Matrix<value_type> const& orig) {
             if (&orig != this) {
-                copy(orig);
+                if (!orig.shareable()) {
+                    copy(orig);
+                } else if (data_ != orig.data_) {
+                    release();
+                    attach(orig);
+                }
+            }
+            return *this;
+        }
+
+        /*
+        * Assigns a matrix expression, forcing its evaluation.
+        *
+        * The expression is evaluated into a new buffer with this matrix's
+        * placement, so rows are computed by the threads that first touch
+        * them, and the expression may reference this matrix.
+        */
+        template<typename E>
+        Matrix<value_type>& operator= (MatrixExpression<value_type, E> const& expr) {
+            bool sharing = shared();
+            Matrix<value_type> result(expr, placement_);
+            swap(result);
+            if (sharing) {
+                share();
             }
             return *this;
         }
 
+        /*
+        * Switches the matrix to shared-storage mode: copies made from it,
+        * and copies of those, share one reference counted buffer, so taking
+        * a snapshot is O(1). The first write through set, the non-const ()
+        * operator or data() to a matrix whose buffer is shared copies the
+        * buffer for that matrix alone.
+        *
+        * A reference or pointer returned by the non-const () operator or
+        * data() could still write into the buffer after it is shared, so
+        * from then on copies of this matrix copy its elements, until it is
+        * resized or share() is called again. Calling share() asserts that
+        * no such reference or pointer is still in use.
+        *
+        * Must not be called while other threads copy the matrix.
+        */
+        void share() {
+            if (refs_ == nullptr) {
+                refs_ = new std::atomic<size_t>(1);
+            }
+            leaked_ = false;
+        }
+
+        /*
+        * Returns true if the matrix is in shared-storage mode.
+        */
+        bool shared() const {
+            return refs_ != nullptr;
+        }
+
+        /*
+        * Exchanges the contents of this matrix and other without copying
+        * elements.
+        */
+        void swap(Matrix<value_type>& other) {
+            std::swap(data_, other.data_);
+            std::swap(refs_, other.refs_);
+            std::swap(leaked_, other.leaked_);
+            std::swap(placement_, other.placement_);
+            size_t rows = this->rows(), cols = this->cols();
+            this->set_dimension(other.rows(), other.cols());
+            other.set_dimension(rows, cols);
+        }
+
         /*
         * Assign value as the element in the matrix at the location
         * specified by row and col, with bounds checking.
         */
         void set(size_t row, size_t col, value_type value) {
             check_bounds(row, col);
+            detach();
             data_[row * this->cols() + col] = value;
         }
 
@@ -160,9 +421,26 @@ namespace linear_algebra {
         */
         value_type& operator () (size_t row, size_t col) {
             check_bounds(row, col);
+            leak();
             return data_[row * this->cols() + col];
         }
 
+        /*
+        * Returns a pointer to the row-major element array.
+        */
+        value_type* data() {
+            leak();
+            return data_;
+        }
+
+        value_type const* data() const {
+            return data_;
+        }
+
+        Placement placement() const {
+            return placement_;
+        }
+
     protected:
 
         /*
@@ -170,36 +448,144 @@ namespace linear_algebra {
         */
         void init(size_t rows, size_t cols) {
             resize_(rows, cols);
-            std::fill_n(data_, this->size(), value_type());
+            for_rows([this](size_t begin, size_t end) {
+                std::fill(data_ + begin * this->cols(), data_ + end * this->cols(), value_type());
+            });
         }
 
         /*
         * Copies in matrix/matrix expression.
+        *
+        * Rows are evaluated by the same pinned threads that first touch them,
+        * so each thread computes rows whose pages live on its own node.
         */
         template<typename T2, typename E>
         void copy(MatrixExpression<T2, E> const& expr) {
             resize_(expr.rows(), expr.cols());
-            // std::cout << expr.rows() << " " << expr.cols() << std::endl;
-            for (size_t row = 0; row < this->rows(); ++row) {
-                for (size_t col = 0; col < this->cols(); ++col) {
-                    data_[row * this->cols() + col] = static_cast<value_type>(expr(row, col));
-                } 
+            for_rows([this, &expr](size_t begin, size_t end) {
+                for (size_t row = begin; row < end; ++row) {
+                    for (size_t col = 0; col < this->cols(); ++col) {
+                        data_[row * this->cols() + col] = static_cast<value_type>(expr(row, col));
+                    }
+                }
+            });
+        }
+
+        /*
+        * Copies in matrix row by row.
+        */
+        void copy(Matrix<value_type> const& orig) {
+            resize_(orig.rows(), orig.cols());
+            value_type const* source = orig.data_;
+            for_rows([this, source](size_t begin, size_t end) {
+                std::copy(source + begin * this->cols(), source + end * this->cols(), data_ + begin * this->cols());
+            });
+        }
+
+        /*
+        * Calls fn(begin, end) over row ranges covering the matrix, spread
+        * across pinned threads according to the placement policy.
+        */
+        template<typename F>
+        void for_rows(F fn) {
+            size_t rows = this->rows();
+            if (placement_ == Placement::local || this->size() < detail::parallel_threshold) {
+                fn(0, rows);
+                return;
+            }
+            std::vector<size_t> cpus = detail::allowed_cpus();
+            if (placement_ == Placement::row_blocks) {
+                detail::parallel_for(rows, (rows + cpus.size() - 1) / cpus.size(), cpus, fn);
+            } else {
+                size_t row_bytes = this->cols() * sizeof(value_type);
+                detail::parallel_for(rows, std::max<size_t>(1, detail::page_size / row_bytes), cpus, fn);
             }
         }
 
         /*
         * Resizes matrix to new specified dimensions.
+        *
+        * A new buffer is left untouched so that its first write, made
+        * through for_rows, decides where its pages are placed.
         */
         void resize_(size_t m, size_t n) {
-            if (data_ != nullptr && (this->rows() != m || this->cols() != n)) {
-                delete[] data_;
-                data_ = nullptr;
+            bool sharing = shared();
+            if (data_ != nullptr && (this->rows() != m || this->cols() != n ||
+                (sharing && refs_->load(std::memory_order_acquire) > 1))) {
+                // the old contents are about to be overwritten, never copy them
+                release();
             }
 
             if (data_ == nullptr) {
                 this->set_dimension(m, n);
                 data_ = new value_type[this->rows() * this->cols()];
+                leaked_ = false;
+                if (sharing) {
+                    refs_ = new std::atomic<size_t>(1);
+                }
+            }
+        }
+
+        /*
+        * Returns true if copies of this matrix may share its buffer.
+        */
+        bool shareable() const {
+            return shared() && !leaked_;
+        }
+
+        /*
+        * Makes this matrix another owner of orig's shared buffer.
+        */
+        void attach(Matrix<value_type> const& orig) {
+            orig.refs_->fetch_add(1, std::memory_order_relaxed);
+            data_ = orig.data_;
+            refs_ = orig.refs_;
+            leaked_ = false;
+            this->set_dimension(orig.rows(), orig.cols());
+        }
+
+        /*
+        * Gives this matrix its own copy of a buffer it shares with other
+        * matrices, before the buffer is written.
+        */
+        void detach() {
+            if (refs_ == nullptr || refs_->load(std::memory_order_acquire) == 1) {
+                return;
+            }
+            value_type const* source = data_;
+            std::atomic<size_t>* source_refs = refs_;
+            data_ = new value_type[this->size()];
+            refs_ = new std::atomic<size_t>(1);
+            for_rows([this, source](size_t begin, size_t end) {
+                std::copy(source + begin * this->cols(), source + end * this->cols(), data_ + begin * this->cols());
+            });
+            if (source_refs->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete[] source;
+                delete source_refs;
+            }
+        }
+
+        /*
+        * Detaches before handing out a writable reference or pointer into
+        * the buffer, and stops later copies from sharing the buffer while
+        * it may still be written through it.
+        */
+        void leak() {
+            detach();
+            leaked_ = shared();
+        }
+
+        /*
+        * Drops this matrix's ownership of its buffer, freeing it if no other
+        * matrix shares it.
+        */
+        void release() {
+            if (refs_ == nullptr || refs_->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete[] data_;
+                delete refs_;
             }
+            data_ = nullptr;
+            refs_ = nullptr;
         }
 
         /*
@@ -215,6 +601,16 @@ namespace linear_algebra {
 
     private:
         value_type* data_ = nullptr;
+        // owner count of data_ in shared-storage mode, nullptr otherwise
+        std::atomic<size_t>* refs_ = nullptr;
+        // a writable reference or pointer into data_ has been handed out
+        bool leaked_ = false;
+        Placement placement_ = Placement::local;
+    };
+
+    template<typename T>
+    struct operand_traits<Matrix<T>> {
+        typedef Matrix<T> const& type;
     };
 
 
@@ -242,9 +638,29 @@ namespace linear_algebra {
                 return left_operand(row, col) + right_operand(row, col);
             }
 
+            left_expr const& left() const {
+                return left_operand;
+            }
+
+            right_expr const& right() const {
+                return right_operand;
+            }
+
+            std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+                return span(left_operand.nonzero_cols(row), right_operand.nonzero_cols(row));
+            }
+
+            std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+                return span(left_operand.nonzero_rows(col), right_operand.nonzero_rows(col));
+            }
+
         private:
-            left_expr const& left_operand;
-            right_expr const& right_operand;
+            typename operand_traits<left_expr>::type left_operand;
+            typename operand_traits<right_expr>::type right_operand;
+
+        static std::pair<size_t, size_t> span(std::pair<size_t, size_t> a, std::pair<size_t, size_t> b) {
+            return std::make_pair(std::min(a.first, b.first), std::max(a.second, b.second));
+        }
 
         /*
         * Checks that matrix addition is defined for the left and
@@ -270,9 +686,9 @@ namespace linear_algebra {
     * E2 the type of Expression of the right-hand operand.
     */
     template<typename T, typename E1, typename E2>
-    Addition<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>
+    Addition<T, E1, E2>
     add(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
-        return Addition<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>(left, right);
+        return Addition<T, E1, E2>(static_cast<E1 const&>(left), static_cast<E2 const&>(right));
     }
 
     /*
@@ -282,9 +698,9 @@ namespace linear_algebra {
     * E2 the type of Expression of the right-hand operand.
     */
     template<typename T, typename E1, typename E2>
-    Addition<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>
+    Addition<T, E1, E2>
     operator+(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
-        return Addition<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>(left, right);
+        return Addition<T, E1, E2>(static_cast<E1 const&>(left), static_cast<E2 const&>(right));
     }
 
 
@@ -314,20 +730,34 @@ namespace linear_algebra {
         * specified by 'row' and the column vector in the right operand
         * specified by 'col'.
         *
+        * Only indices where both vectors may be non-zero are visited, so
+        * structured operands skip their known zeros.
+        *
         * row the index of the row in the left operand
         * col the index of the column in the right operand 
         */
         value_type operator () (size_t row, size_t col) const {
+            std::pair<size_t, size_t> left_range = left_operand.nonzero_cols(row);
+            std::pair<size_t, size_t> right_range = right_operand.nonzero_rows(col);
+            size_t end = std::min(left_range.second, right_range.second);
             value_type dot_product = value_type();
-            for (size_t i = 0; i < left_operand.cols(); ++i) {
+            for (size_t i = std::max(left_range.first, right_range.first); i < end; ++i) {
                 dot_product += left_operand(row, i) * right_operand(i, col);
             }
             return dot_product;
         }
 
+        left_expr const& left() const {
+            return left_operand;
+        }
+
+        right_expr const& right() const {
+            return right_operand;
+        }
+
     private:
-        left_expr const& left_operand;
-        right_expr const& right_operand;
+        typename operand_traits<left_expr>::type left_operand;
+        typename operand_traits<right_expr>::type right_operand;
 
         /*
         * Checks that matrix multiplication is defined for the left and
@@ -345,31 +775,6 @@ namespace linear_algebra {
 
     };
 
-    /*
-    * Matrix multiplication.
-    *
-    * T the value type
-    * E1 the type of Expression of the left-hand operand.
-    * E2 the type of Expression of the right-hand operand.
-    */
-    template<typename T, typename E1, typename E2>
-    Multiplication<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>
-    mult(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
-        return Multiplication<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>(left, right);
-    }
-
-    /*
-    * Overload * operator for Multiplication Expression Template.
-    *
-    * E1 the type of Expression of the left-hand operand.
-    * E2 the type of Expression of the right-hand operand.
-    */
-    template<typename T, typename E1, typename E2>
-    Multiplication<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>
-    operator*(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
-        return Multiplication<T, MatrixExpression<T, E1>, MatrixExpression<T, E2>>(left, right);
-    }
-
     /*
     * Transpose Expression Template.
     *
@@ -392,17 +797,1842 @@ namespace linear_algebra {
             return operand_(col, row);
         }
 
+        expr_type const& operand() const {
+            return operand_;
+        }
+
+        std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+            return operand_.nonzero_rows(row);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+            return operand_.nonzero_cols(col);
+        }
+
     private:
-        expr_type const& operand_;
+        typename operand_traits<expr_type>::type operand_;
     };
 
     /*
-    * Transpose Matrix.
+    * Scalar Multiplication Expression Template.
     *
-    * E the type of Expression of the operand.
+    * T the value type.
+    * E the expression type.
+    */
+    template<typename T, typename E>
+    class ScalarMultiplication : public MatrixExpression<T, ScalarMultiplication<T, E>> {
+        typedef T value_type;
+        typedef E expr_type;
+
+    public:
+
+        ScalarMultiplication(value_type scalar, expr_type const& operand)
+        : scalar_(scalar), operand_(operand) {
+            this->set_dimension(operand.rows(), operand.cols());
+        }
+
+        value_type operator () (size_t row, size_t col) const {
+            return scalar_ * operand_(row, col);
+        }
+
+        value_type scalar() const {
+            return scalar_;
+        }
+
+        expr_type const& operand() const {
+            return operand_;
+        }
+
+        std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+            return operand_.nonzero_cols(row);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+            return operand_.nonzero_rows(col);
+        }
+
+    private:
+        value_type scalar_;
+        typename operand_traits<expr_type>::type operand_;
+    };
+
+    /*
+    * Rewrite rules.
+    *
+    * trans, * and scalar * do not build their node directly but go through
+    * a rule, and partial specializations of the rules replace the node with
+    * a cheaper equivalent tree while the expression is being built:
+    *
+    *   trans(trans(x))      -> x
+    *   trans(a + b)         -> trans(a) + trans(b)
+    *   trans(trans(a) * b)  -> trans(b) * a          (likewise a * trans(b))
+    *   trans(s * x)         -> s * trans(x)
+    *   s * (t * x)          -> (s * t) * x
+    *   (s * a) * (t * b)    -> (s * t) * (a * b)
+    *
+    * trans(a * b) is only reversed when that cancels a transpose; otherwise
+    * both forms read memory the same way and it is left as written.
+    *
+    * type is the rewritten expression type and apply() builds it, returning
+    * matrices by reference and expression nodes by value.
     */
     template<typename T, typename E>
-    Transpose<T, MatrixExpression<T, E>> trans(MatrixExpression<T, E> const& operand) {
-        return Transpose<T, MatrixExpression<T, E>>(operand);
+    struct transpose_rule {
+        typedef Transpose<T, E> type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(E const& operand) {
+            return type(operand);
+        }
+    };
+
+    template<typename T, typename E1, typename E2>
+    struct product_rule {
+        typedef Multiplication<T, E1, E2> type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(E1 const& left, E2 const& right) {
+            return type(left, right);
+        }
+    };
+
+    template<typename T, typename E>
+    struct scale_rule {
+        typedef ScalarMultiplication<T, E> type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(T scalar, E const& operand) {
+            return type(scalar, operand);
+        }
+    };
+
+    // trans(trans(x)) -> x
+    template<typename T, typename E>
+    struct transpose_rule<T, Transpose<T, E>> {
+        typedef E type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(Transpose<T, E> const& operand) {
+            return operand.operand();
+        }
+    };
+
+    // trans(a + b) -> trans(a) + trans(b)
+    template<typename T, typename E1, typename E2>
+    struct transpose_rule<T, Addition<T, E1, E2>> {
+        typedef transpose_rule<T, E1> left_rule;
+        typedef transpose_rule<T, E2> right_rule;
+        typedef Addition<T, typename left_rule::type, typename right_rule::type> type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(Addition<T, E1, E2> const& operand) {
+            return type(left_rule::apply(operand.left()), right_rule::apply(operand.right()));
+        }
+    };
+
+    // trans(a * b) -> trans(b) * trans(a)
+    template<typename T, typename E1, typename E2>
+    struct reversed_product_rule {
+        typedef transpose_rule<T, E1> left_rule;
+        typedef transpose_rule<T, E2> right_rule;
+        typedef product_rule<T, typename right_rule::type, typename left_rule::type> rule;
+        typedef typename rule::type type;
+        typedef typename rule::result result;
+
+        static result apply(Multiplication<T, E1, E2> const& operand) {
+            return rule::apply(right_rule::apply(operand.right()), left_rule::apply(operand.left()));
+        }
+    };
+
+    template<typename T, typename E1, typename E2>
+    struct transpose_rule<T, Multiplication<T, Transpose<T, E1>, E2>>
+    : reversed_product_rule<T, Transpose<T, E1>, E2> {};
+
+    template<typename T, typename E1, typename E2>
+    struct transpose_rule<T, Multiplication<T, E1, Transpose<T, E2>>>
+    : reversed_product_rule<T, E1, Transpose<T, E2>> {};
+
+    template<typename T, typename E1, typename E2>
+    struct transpose_rule<T, Multiplication<T, Transpose<T, E1>, Transpose<T, E2>>>
+    : reversed_product_rule<T, Transpose<T, E1>, Transpose<T, E2>> {};
+
+    // trans(s * x) -> s * trans(x)
+    template<typename T, typename E>
+    struct transpose_rule<T, ScalarMultiplication<T, E>> {
+        typedef transpose_rule<T, E> operand_rule;
+        typedef scale_rule<T, typename operand_rule::type> rule;
+        typedef typename rule::type type;
+        typedef typename rule::result result;
+
+        static result apply(ScalarMultiplication<T, E> const& operand) {
+            return rule::apply(operand.scalar(), operand_rule::apply(operand.operand()));
+        }
+    };
+
+    // s * (t * x) -> (s * t) * x
+    template<typename T, typename E>
+    struct scale_rule<T, ScalarMultiplication<T, E>> {
+        typedef ScalarMultiplication<T, E> type;
+        typedef typename operand_traits<type>::type result;
+
+        static result apply(T scalar, ScalarMultiplication<T, E> const& operand) {
+            return type(scalar * operand.scalar(), operand.operand());
+        }
+    };
+
+    // (s * a) * b -> s * (a * b)
+    template<typename T, typename E1, typename E2>
+    struct product_rule<T, ScalarMultiplication<T, E1>, E2> {
+        typedef product_rule<T, E1, E2> product;
+        typedef scale_rule<T, typename product::type> rule;
+        typedef typename rule::type type;
+        typedef typename rule::result result;
+
+        static result apply(ScalarMultiplication<T, E1> const& left, E2 const& right) {
+            return rule::apply(left.scalar(), product::apply(left.operand(), right));
+        }
+    };
+
+    // a * (t * b) -> t * (a * b)
+    template<typename T, typename E1, typename E2>
+    struct product_rule<T, E1, ScalarMultiplication<T, E2>> {
+        typedef product_rule<T, E1, E2> product;
+        typedef scale_rule<T, typename product::type> rule;
+        typedef typename rule::type type;
+        typedef typename rule::result result;
+
+        static result apply(E1 const& left, ScalarMultiplication<T, E2> const& right) {
+            return rule::apply(right.scalar(), product::apply(left, right.operand()));
+        }
+    };
+
+    // (s * a) * (t * b) -> (s * t) * (a * b)
+    template<typename T, typename E1, typename E2>
+    struct product_rule<T, ScalarMultiplication<T, E1>, ScalarMultiplication<T, E2>> {
+        typedef product_rule<T, E1, E2> product;
+        typedef scale_rule<T, typename product::type> rule;
+        typedef typename rule::type type;
+        typedef typename rule::result result;
+
+        static result apply(ScalarMultiplication<T, E1> const& left, ScalarMultiplication<T, E2> const& right) {
+            return rule::apply(left.scalar() * right.scalar(), product::apply(left.operand(), right.operand()));
+        }
+    };
+
+    /*
+    * Matrix multiplication.
+    *
+    * T the value type
+    * E1 the type of Expression of the left-hand operand.
+    * E2 the type of Expression of the right-hand operand.
+    */
+    template<typename T, typename E1, typename E2>
+    typename product_rule<T, E1, E2>::result
+    mult(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
+        return product_rule<T, E1, E2>::apply(static_cast<E1 const&>(left), static_cast<E2 const&>(right));
+    }
+
+    /*
+    * Overload * operator for Multiplication Expression Template.
+    *
+    * E1 the type of Expression of the left-hand operand.
+    * E2 the type of Expression of the right-hand operand.
+    */
+    template<typename T, typename E1, typename E2>
+    typename product_rule<T, E1, E2>::result
+    operator*(MatrixExpression<T, E1> const& left, MatrixExpression<T, E2> const& right) {
+        return product_rule<T, E1, E2>::apply(static_cast<E1 const&>(left), static_cast<E2 const&>(right));
+    }
+
+    /*
+    * Overload * operator for Scalar Multiplication Expression Template.
+    *
+    * The scalar is converted to the value type of the matrix. Scalars that
+    * would be truncated, such as 2.5 for a Matrix<int>, are rejected at
+    * compile time.
+    *
+    * E the type of Expression of the matrix operand.
+    * S the type of the scalar.
+    */
+    template<typename T, typename E, typename S>
+    typename std::enable_if<detail::is_scalar_for<S, T>::value, typename scale_rule<T, E>::result>::type
+    operator*(S scalar, MatrixExpression<T, E> const& operand) {
+        return scale_rule<T, E>::apply(static_cast<T>(scalar), static_cast<E const&>(operand));
+    }
+
+    template<typename T, typename E, typename S>
+    typename std::enable_if<detail::is_scalar_for<S, T>::value, typename scale_rule<T, E>::result>::type
+    operator*(MatrixExpression<T, E> const& operand, S scalar) {
+        return scale_rule<T, E>::apply(static_cast<T>(scalar), static_cast<E const&>(operand));
+    }
+
+    /*
+    * Transpose Matrix.
+    *
+    * E the type of Expression of the operand.
+    */
+    template<typename T, typename E>
+    typename transpose_rule<T, E>::result trans(MatrixExpression<T, E> const& operand) {
+        return transpose_rule<T, E>::apply(static_cast<E const&>(operand));
+    }
+
+    namespace detail {
+
+        /*
+        * Returns element (i, j) of a row-major buffer with leading dimension
+        * ld, read as its transpose when transposed is set.
+        */
+        template<typename T>
+        inline T const& at(T const* data, size_t ld, bool transposed, size_t i, size_t j) {
+            return transposed ? data[j * ld + i] : data[i * ld + j];
+        }
+
+        /*
+        * c = op(a), where c is a rows x cols row-major buffer.
+        */
+        template<typename T>
+        void copy(T const* a, size_t lda, bool ta, T* c, size_t rows, size_t cols) {
+            if (!ta) {
+                for (size_t i = 0; i < rows; ++i) {
+                    std::copy(a + i * lda, a + i * lda + cols, c + i * cols);
+                }
+                return;
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    c[i * cols + j] = a[j * lda + i];
+                }
+            }
+        }
+
+        /*
+        * c = alpha * op(a), where c is a rows x cols row-major buffer.
+        */
+        template<typename T>
+        void scale(T alpha, T const* a, size_t lda, bool ta, T* c, size_t rows, size_t cols) {
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    c[i * cols + j] = alpha * at(a, lda, ta, i, j);
+                }
+            }
+        }
+
+        /*
+        * c = op(a) + op(b), where c is a rows x cols row-major buffer.
+        */
+        template<typename T>
+        void add(T const* a, size_t lda, bool ta, T const* b, size_t ldb, bool tb,
+                 T* c, size_t rows, size_t cols) {
+            if (!ta && !tb) {
+                for (size_t i = 0; i < rows * cols; ++i) {
+                    c[i] = a[i] + b[i];
+                }
+                return;
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    c[i * cols + j] = at(a, lda, ta, i, j) + at(b, ldb, tb, i, j);
+                }
+            }
+        }
+
+        /*
+        * c = op(a) * op(b), where op(a) is m x n, op(b) is n x p and c is a
+        * m x p row-major buffer that must not alias a or b.
+        *
+        * The loop order is chosen per transpose combination so that the
+        * innermost loop walks memory with unit stride whenever possible.
+        */
+        template<typename T>
+        void gemm(T const* a, size_t lda, bool ta, T const* b, size_t ldb, bool tb,
+                  T* c, size_t m, size_t n, size_t p) {
+            if (!tb) {
+                // i-k-j: rows of b and c are walked contiguously
+                for (size_t i = 0; i < m; ++i) {
+                    T* c_row = c + i * p;
+                    std::fill_n(c_row, p, T());
+                    for (size_t k = 0; k < n; ++k) {
+                        T const a_ik = at(a, lda, ta, i, k);
+                        T const* b_row = b + k * ldb;
+                        for (size_t j = 0; j < p; ++j) {
+                            c_row[j] += a_ik * b_row[j];
+                        }
+                    }
+                }
+            } else if (!ta) {
+                // columns of op(b) are rows of b: dot products of two rows
+                for (size_t i = 0; i < m; ++i) {
+                    T const* a_row = a + i * lda;
+                    for (size_t j = 0; j < p; ++j) {
+                        T const* b_row = b + j * ldb;
+                        T dot_product = T();
+                        for (size_t k = 0; k < n; ++k) {
+                            dot_product += a_row[k] * b_row[k];
+                        }
+                        c[i * p + j] = dot_product;
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < m; ++i) {
+                    for (size_t j = 0; j < p; ++j) {
+                        T dot_product = T();
+                        for (size_t k = 0; k < n; ++k) {
+                            dot_product += a[k * lda + i] * b[j * ldb + k];
+                        }
+                        c[i * p + j] = dot_product;
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+    * Compiled evaluation plan for a matrix expression.
+    *
+    * An expression stays valid while the matrices it references live, but
+    * it is re-analysed every time it is evaluated. A Plan walks the
+    * expression tree once: operand matrices are bound by address, transposes
+    * are folded into the kernels that consume them and every intermediate
+    * result gets a preallocated scratch matrix. execute() then re-runs the
+    * computation over the current contents of the bound matrices without
+    * allocating.
+    *
+    * The bound matrices must outlive the plan and keep the dimensions they
+    * had when it was compiled; execute() throws a std::logic_error if one
+    * was resized.
+    *
+    * T the value type.
+    */
+    template<typename T>
+    class Plan {
+        typedef T value_type;
+
+    public:
+
+        template<typename E>
+        Plan(MatrixExpression<value_type, E> const& expr) {
+            View root = bind(expr);
+            if (steps_.empty() || root.transposed || slots_[root.slot] != steps_.back().out) {
+                emit(Kernel::copy, root, root, expr.rows(), expr.cols());
+            }
+            output_ = steps_.back().out;
+        }
+
+        size_t rows() const {
+            return output_->rows();
+        }
+
+        size_t cols() const {
+            return output_->cols();
+        }
+
+        /*
+        * Evaluates the expression into the plan's own output matrix.
+        *
+        * Throws a std::logic_error if a bound matrix no longer has the
+        * dimensions it had when the plan was compiled.
+        */
+        Matrix<value_type> const& execute() {
+            check_operands();
+            run_steps();
+            return *output_;
+        }
+
+        /*
+        * Evaluates the expression into out, which must already have the
+        * dimensions of the result.
+        *
+        * Throws a std::logic_error if the dimensions of out differ, or if a
+        * bound matrix was resized; out is then left untouched.
+        */
+        void execute(Matrix<value_type>& out) {
+            if (out.rows() != rows() || out.cols() != cols()) {
+                throw std::logic_error("Plan output must have the dimensions " \
+                    "of the compiled expression.");
+            }
+            check_operands();
+            if (std::find(operands_.begin(), operands_.end(), &out) != operands_.end()) {
+                // out is read by the plan, so it cannot be written in place
+                run_steps();
+                std::copy(output_->data(), output_->data() + output_->size(), out.data());
+                return;
+            }
+            Step& last = steps_.back();
+            last.out = &out;
+            run_steps();
+            last.out = output_;
+        }
+
+    private:
+
+        enum class Kernel { copy, scale, add, mult };
+
+        /*
+        * A slot read either as stored or as its transpose.
+        */
+        struct View {
+            size_t slot;
+            bool transposed;
+        };
+
+        struct Step {
+            Kernel kernel;
+            View left;
+            View right;
+            Matrix<value_type>* out;
+            value_type scalar;
+        };
+
+        std::vector<Matrix<value_type> const*> slots_;
+        std::vector<Matrix<value_type> const*> operands_;
+        // dimensions of each bound matrix when it was bound
+        std::vector<std::pair<size_t, size_t>> shapes_;
+        std::vector<std::unique_ptr<Matrix<value_type>>> scratch_;
+        std::vector<Step> steps_;
+        Matrix<value_type>* output_ = nullptr;
+
+        template<typename E>
+        View bind(MatrixExpression<value_type, E> const& expr) {
+            return bind_node(static_cast<E const&>(expr));
+        }
+
+        View bind_node(Matrix<value_type> const& matrix) {
+            slots_.push_back(&matrix);
+            operands_.push_back(&matrix);
+            shapes_.push_back(std::make_pair(matrix.rows(), matrix.cols()));
+            return View{slots_.size() - 1, false};
+        }
+
+        /*
+        * Checks that the bound matrices kept the dimensions the kernels
+        * were compiled for.
+        *
+        * Throws a std::logic_error if one of them was resized.
+        */
+        void run_steps() {
+            for (Step const& step : steps_) {
+                run(step);
+            }
+        }
+
+        void check_operands() const {
+            for (size_t i = 0; i < operands_.size(); ++i) {
+                if (operands_[i]->rows() != shapes_[i].first || operands_[i]->cols() != shapes_[i].second) {
+                    throw std::logic_error("A matrix bound to a Plan was resized " \
+                        "after the plan was compiled.");
+                }
+            }
+        }
+
+        template<typename E1, typename E2>
+        View bind_node(Addition<value_type, E1, E2> const& expr) {
+            View left = bind(expr.left());
+            View right = bind(expr.right());
+            return emit(Kernel::add, left, right, expr.rows(), expr.cols());
+        }
+
+        template<typename E1, typename E2>
+        View bind_node(Multiplication<value_type, E1, E2> const& expr) {
+            View left = bind(expr.left());
+            View right = bind(expr.right());
+            return emit(Kernel::mult, left, right, expr.rows(), expr.cols());
+        }
+
+        template<typename E>
+        View bind_node(Transpose<value_type, E> const& expr) {
+            View view = bind(expr.operand());
+            view.transposed = !view.transposed;
+            return view;
+        }
+
+        template<typename E>
+        View bind_node(ScalarMultiplication<value_type, E> const& expr) {
+            View view = bind(expr.operand());
+            return emit(Kernel::scale, view, view, expr.rows(), expr.cols(), expr.scalar());
+        }
+
+        /*
+        * Appends a step writing into a fresh scratch matrix and returns
+        * the slot holding its result.
+        */
+        View emit(Kernel kernel, View left, View right, size_t rows, size_t cols,
+                  value_type scalar = value_type()) {
+            // plans execute on the calling thread, so keep scratch local to it
+            scratch_.emplace_back(new Matrix<value_type>(rows, cols, Placement::local));
+            Matrix<value_type>* out = scratch_.back().get();
+            steps_.push_back(Step{kernel, left, right, out, scalar});
+            slots_.push_back(out);
+            return View{slots_.size() - 1, false};
+        }
+
+        void run(Step const& step) {
+            Matrix<value_type> const& left = *slots_[step.left.slot];
+            Matrix<value_type> const& right = *slots_[step.right.slot];
+            Matrix<value_type>& out = *step.out;
+            switch (step.kernel) {
+                case Kernel::copy:
+                    detail::copy(left.data(), left.cols(), step.left.transposed,
+                        out.data(), out.rows(), out.cols());
+                    break;
+                case Kernel::scale:
+                    detail::scale(step.scalar, left.data(), left.cols(), step.left.transposed,
+                        out.data(), out.rows(), out.cols());
+                    break;
+                case Kernel::add:
+                    detail::add(left.data(), left.cols(), step.left.transposed,
+                        right.data(), right.cols(), step.right.transposed,
+                        out.data(), out.rows(), out.cols());
+                    break;
+                case Kernel::mult:
+                    detail::gemm(left.data(), left.cols(), step.left.transposed,
+                        right.data(), right.cols(), step.right.transposed,
+                        out.data(), out.rows(), step.left.transposed ? left.rows() : left.cols(),
+                        out.cols());
+                    break;
+            }
+        }
+    };
+
+    /*
+    * Compiles a matrix expression into a reusable Plan.
+    *
+    * E the type of Expression to compile.
+    */
+    template<typename T, typename E>
+    Plan<T> make_plan(MatrixExpression<T, E> const& expr) {
+        return Plan<T>(expr);
+    }
+
+    namespace detail {
+
+        /*
+        * Returns the dot product of the n-element buffers x and y.
+        */
+        template<typename T>
+        T dot(T const* x, T const* y, size_t n) {
+            T dot_product = T();
+            for (size_t i = 0; i < n; ++i) {
+                dot_product += x[i] * y[i];
+            }
+            return dot_product;
+        }
+
+        /*
+        * y += alpha * x over n-element buffers.
+        */
+        template<typename T>
+        void axpy(T alpha, T const* x, T* y, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                y[i] += alpha * x[i];
+            }
+        }
+
+        /*
+        * y = op(a) * x, where op(a) is m x n and a is row-major with leading
+        * dimension lda.
+        *
+        * Without transposition every y[i] is a dot product with a row of a;
+        * with it, y accumulates rows of a scaled by x, so both forms stream
+        * through a with unit stride.
+        */
+        template<typename T>
+        void gemv(T const* a, size_t lda, bool transposed, T const* x, T* y, size_t m, size_t n) {
+            if (!transposed) {
+                for (size_t i = 0; i < m; ++i) {
+                    y[i] = dot(a + i * lda, x, n);
+                }
+                return;
+            }
+            std::fill_n(y, m, T());
+            for (size_t k = 0; k < n; ++k) {
+                axpy(x[k], a + k * lda, y, m);
+            }
+        }
+
+        /*
+        * a += alpha * x * trans(y), where x has m elements, y has n elements
+        * and a is m x n row-major with leading dimension lda.
+        */
+        template<typename T>
+        void ger(T alpha, T const* x, T const* y, T* a, size_t lda, size_t m, size_t n) {
+            for (size_t i = 0; i < m; ++i) {
+                axpy(alpha * x[i], y, a + i * lda, n);
+            }
+        }
+    }
+
+    /*
+    * Orientation of a Vector: an Nx1 column or a 1xN row.
+    */
+    enum class Orientation { column, row };
+
+    template<typename T, typename E>
+    class MatrixVectorProduct;
+
+    template<typename T, typename E>
+    class VectorMatrixProduct;
+
+    /*
+    * A Vector of N values of type T, taking part in matrix expressions as an
+    * Nx1 (column) or 1xN (row) matrix.
+    *
+    * T the type of object stored in the Vector.
+    * O the orientation of the Vector.
+    */
+    template<typename T, Orientation O = Orientation::column>
+    class Vector : public MatrixExpression<T, Vector<T, O>> {
+        typedef T value_type;
+
+    public:
+
+        /*
+        * Default constructor.
+        */
+        Vector() {
+            init(0);
+        }
+
+        /*
+        * Standard constructor.
+        */
+        explicit Vector(size_t n) {
+            init(n);
+        }
+
+        /*
+        * Copy constructor.
+        */
+        Vector(Vector<value_type, O> const& orig) {
+            copy(orig);
+        }
+
+        /*
+        * Constructs vector from a matrix expression, forcing its evaluation.
+        *
+        * Throws a std::logic_error if the expression is not a single
+        * column (row) for a column (row) vector.
+        */
+        template<typename E>
+        Vector(MatrixExpression<value_type, E> const& expr) {
+            copy(static_cast<E const&>(expr));
+        }
+
+        /*
+        * Initializer list constructor.
+        */
+        template<typename T2>
+        Vector(const std::initializer_list<T2> list) {
+            resize_(list.size());
+            std::transform(list.begin(), list.end(), data_, [](T2 element) {
+                return static_cast<value_type>(element);
+            });
+        }
+
+        /*
+        * Destructor.
+        */
+        ~Vector() {
+            if (data_ != nullptr) {
+                delete[] data_;
+            }
+        }
+
+        /*
+        * Copy assignment operator.
+        */
+        Vector<value_type, O>& operator= (Vector<value_type, O> const& orig) {
+            if (&orig != this) {
+                copy(orig);
+            }
+            return *this;
+        }
+
+        /*
+        * Assigns a matrix-vector (vector-matrix) product, writing it into
+        * this vector's buffer in a single GEMV pass. When the product reads
+        * this vector, as in x = A * x, it is evaluated into a temporary.
+        */
+        template<typename E>
+        Vector<value_type, O>& operator= (MatrixVectorProduct<value_type, E> const& expr) {
+            assign(expr);
+            return *this;
+        }
+
+        template<typename E>
+        Vector<value_type, O>& operator= (VectorMatrixProduct<value_type, E> const& expr) {
+            assign(expr);
+            return *this;
+        }
+
+        /*
+        * Assign value as the i-th element of the vector, with bounds checking.
+        */
+        void set(size_t i, value_type value) {
+            check_bounds(i);
+            data_[i] = value;
+        }
+
+        /*
+        * Returns the i-th element of the vector, with bounds checking.
+        *
+        * If i is not within the range of the vector, an exception
+        * of type std::out_of_range is thrown.
+        */
+        value_type operator () (size_t i) const {
+            check_bounds(i);
+            return data_[i];
+        }
+
+        value_type& operator () (size_t i) {
+            check_bounds(i);
+            return data_[i];
+        }
+
+        /*
+        * Returns the element at the location specified by row and col of
+        * the vector viewed as a matrix, with bounds checking.
+        */
+        value_type operator () (size_t row, size_t col) const {
+            if (row >= this->rows() || col >= this->cols()) {
+                throw std::out_of_range("Index out of bounds.");
+            }
+            return data_[row + col];
+        }
+
+        value_type* data() {
+            return data_;
+        }
+
+        value_type const* data() const {
+            return data_;
+        }
+
+    protected:
+
+        /*
+        * Initialize vector with default values.
+        */
+        void init(size_t n) {
+            resize_(n);
+            std::fill_n(data_, n, value_type());
+        }
+
+        /*
+        * Copies in vector/matrix expression.
+        */
+        template<typename T2, typename E>
+        void copy(MatrixExpression<T2, E> const& expr) {
+            check_shape(expr);
+            resize_(expr.size());
+            for (size_t i = 0; i < this->size(); ++i) {
+                data_[i] = static_cast<value_type>(O == Orientation::column ? expr(i, 0) : expr(0, i));
+            }
+        }
+
+        /*
+        * Copies in vector buffer.
+        */
+        void copy(Vector<value_type, O> const& orig) {
+            resize_(orig.size());
+            std::copy(orig.data_, orig.data_ + orig.size(), data_);
+        }
+
+        /*
+        * Evaluates matrix-vector products in a single GEMV pass.
+        */
+        template<typename E>
+        void copy(MatrixVectorProduct<value_type, E> const& expr) {
+            check_shape(expr);
+            resize_(expr.size());
+            expr.evaluate(data_);
+        }
+
+        template<typename E>
+        void copy(VectorMatrixProduct<value_type, E> const& expr) {
+            check_shape(expr);
+            resize_(expr.size());
+            expr.evaluate(data_);
+        }
+
+        /*
+        * Evaluates a matrix-vector product in place unless it may read this
+        * vector.
+        */
+        template<typename P>
+        void assign(P const& expr) {
+            if (expr.may_read(data_)) {
+                Vector<value_type, O> result(expr);
+                std::swap(data_, result.data_);
+                this->set_dimension(expr.rows(), expr.cols());
+            } else {
+                copy(expr);
+            }
+        }
+
+        /*
+        * Resizes vector to n elements.
+        */
+        void resize_(size_t n) {
+            if (data_ != nullptr && this->size() != n) {
+                delete[] data_;
+                data_ = nullptr;
+            }
+
+            if (data_ == nullptr) {
+                if (O == Orientation::column) {
+                    this->set_dimension(n, 1);
+                } else {
+                    this->set_dimension(1, n);
+                }
+                data_ = new value_type[n];
+            }
+        }
+
+        /*
+        * Checks that index i is within the vector bounds.
+        *
+        * Throws out_of_range exception for an invalid index.
+        */
+        void check_bounds(size_t i) const {
+            if (i >= this->size()) {
+                throw std::out_of_range("Index out of bounds.");
+            }
+        }
+
+        /*
+        * Checks that expr is a single column (row) for a column (row) vector.
+        *
+        * Throws a std::logic_error if it is not.
+        */
+        template<typename T2, typename E>
+        void check_shape(MatrixExpression<T2, E> const& expr) const {
+            if ((O == Orientation::column && expr.cols() != 1) ||
+                (O == Orientation::row && expr.rows() != 1)) {
+                throw std::logic_error("A vector can only be constructed " \
+                    "from a matrix with a single column (row) for a " \
+                    "column (row) vector.");
+            }
+        }
+
+    private:
+        value_type* data_ = nullptr;
+    };
+
+    template<typename T, Orientation O>
+    struct operand_traits<Vector<T, O>> {
+        typedef Vector<T, O> const& type;
+    };
+
+    /*
+    * A 1xN row Vector.
+    */
+    template<typename T>
+    using RowVector = Vector<T, Orientation::row>;
+
+    /*
+    * Matrix-Vector Multiplication Expression Template, A * x.
+    *
+    * Elements evaluated lazily read x without bounds checks. When the whole
+    * product is assigned to a Vector and A is a Matrix or the transpose of
+    * one, it is computed in a single pass of the GEMV kernel.
+    *
+    * T the value type.
+    * E the type of Expression of the matrix operand.
+    */
+    template<typename T, typename E>
+    class MatrixVectorProduct : public MatrixExpression<T, MatrixVectorProduct<T, E>> {
+        typedef T value_type;
+        typedef E matrix_expr;
+
+    public:
+
+        MatrixVectorProduct(matrix_expr const& left, Vector<value_type> const& right)
+        : left_operand(left), right_operand(right) {
+            if (left_operand.cols() != right_operand.rows()) {
+                throw std::logic_error("Matrix multiplication is only defined " \
+                    "when the number of columns in the left-hand matrix is equal " \
+                    "to the number of rows in the right-hand matrix.");
+            }
+            this->set_dimension(left_operand.rows(), 1);
+        }
+
+        value_type operator () (size_t row, size_t col) const {
+            if (col != 0) {
+                throw std::out_of_range("Index out of bounds.");
+            }
+            value_type const* x = right_operand.data();
+            std::pair<size_t, size_t> range = left_operand.nonzero_cols(row);
+            value_type dot_product = value_type();
+            for (size_t i = range.first; i < range.second; ++i) {
+                dot_product += left_operand(row, i) * x[i];
+            }
+            return dot_product;
+        }
+
+        /*
+        * Writes the whole product into the buffer y.
+        */
+        void evaluate(value_type* y) const {
+            gemv(left_operand, y);
+        }
+
+        /*
+        * Returns true if evaluation may read the buffer y: y holds x, or A
+        * is an expression that could reference it.
+        */
+        bool may_read(value_type const* y) const {
+            return y == right_operand.data() || !stored(left_operand);
+        }
+
+    private:
+        typename operand_traits<matrix_expr>::type left_operand;
+        Vector<value_type> const& right_operand;
+
+        template<typename E2>
+        static bool stored(E2 const&) {
+            return false;
+        }
+
+        static bool stored(Matrix<value_type> const&) {
+            return true;
+        }
+
+        static bool stored(Transpose<value_type, Matrix<value_type>> const&) {
+            return true;
+        }
+
+        template<typename E2>
+        void gemv(E2 const&, value_type* y) const {
+            for (size_t i = 0; i < this->rows(); ++i) {
+                y[i] = (*this)(i, 0);
+            }
+        }
+
+        void gemv(Matrix<value_type> const& a, value_type* y) const {
+            detail::gemv(a.data(), a.cols(), false, right_operand.data(), y, this->rows(), a.cols());
+        }
+
+        void gemv(Transpose<value_type, Matrix<value_type>> const& a, value_type* y) const {
+            Matrix<value_type> const& stored = a.operand();
+            detail::gemv(stored.data(), stored.cols(), true, right_operand.data(), y, this->rows(), stored.rows());
+        }
+    };
+
+    /*
+    * Vector-Matrix Multiplication Expression Template, x * A for a
+    * RowVector x. trans(x) * A of a column vector x is an ordinary
+    * Multiplication.
+    *
+    * Evaluated into a RowVector as the GEMV-transpose trans(A) * x.
+    *
+    * T the value type.
+    * E the type of Expression of the matrix operand.
+    */
+    template<typename T, typename E>
+    class VectorMatrixProduct : public MatrixExpression<T, VectorMatrixProduct<T, E>> {
+        typedef T value_type;
+        typedef E matrix_expr;
+
+    public:
+
+        VectorMatrixProduct(RowVector<value_type> const& left, matrix_expr const& right)
+        : left_operand(left), right_operand(right) {
+            if (left_operand.cols() != right_operand.rows()) {
+                throw std::logic_error("Matrix multiplication is only defined " \
+                    "when the number of columns in the left-hand matrix is equal " \
+                    "to the number of rows in the right-hand matrix.");
+            }
+            this->set_dimension(1, right_operand.cols());
+        }
+
+        value_type operator () (size_t row, size_t col) const {
+            if (row != 0) {
+                throw std::out_of_range("Index out of bounds.");
+            }
+            value_type const* x = left_operand.data();
+            std::pair<size_t, size_t> range = right_operand.nonzero_rows(col);
+            value_type dot_product = value_type();
+            for (size_t i = range.first; i < range.second; ++i) {
+                dot_product += x[i] * right_operand(i, col);
+            }
+            return dot_product;
+        }
+
+        /*
+        * Writes the whole product into the buffer y.
+        */
+        void evaluate(value_type* y) const {
+            gemv(right_operand, y);
+        }
+
+        /*
+        * Returns true if evaluation may read the buffer y: y holds x, or A
+        * is an expression that could reference it.
+        */
+        bool may_read(value_type const* y) const {
+            return y == left_operand.data() || !stored(right_operand);
+        }
+
+    private:
+        RowVector<value_type> const& left_operand;
+        typename operand_traits<matrix_expr>::type right_operand;
+
+        template<typename E2>
+        static bool stored(E2 const&) {
+            return false;
+        }
+
+        static bool stored(Matrix<value_type> const&) {
+            return true;
+        }
+
+        static bool stored(Transpose<value_type, Matrix<value_type>> const&) {
+            return true;
+        }
+
+        template<typename E2>
+        void gemv(E2 const&, value_type* y) const {
+            for (size_t j = 0; j < this->cols(); ++j) {
+                y[j] = (*this)(0, j);
+            }
+        }
+
+        void gemv(Matrix<value_type> const& a, value_type* y) const {
+            detail::gemv(a.data(), a.cols(), true, left_operand.data(), y, this->cols(), a.rows());
+        }
+
+        void gemv(Transpose<value_type, Matrix<value_type>> const& a, value_type* y) const {
+            Matrix<value_type> const& stored = a.operand();
+            detail::gemv(stored.data(), stored.cols(), false, left_operand.data(), y, this->cols(), stored.cols());
+        }
+    };
+
+    /*
+    * Matrix-vector multiplication.
+    *
+    * E the type of Expression of the matrix operand.
+    */
+    template<typename T, typename E>
+    MatrixVectorProduct<T, E>
+    mult(MatrixExpression<T, E> const& left, Vector<T> const& right) {
+        return MatrixVectorProduct<T, E>(static_cast<E const&>(left), right);
+    }
+
+    template<typename T, typename E>
+    MatrixVectorProduct<T, E>
+    operator*(MatrixExpression<T, E> const& left, Vector<T> const& right) {
+        return MatrixVectorProduct<T, E>(static_cast<E const&>(left), right);
+    }
+
+    /*
+    * Vector-matrix multiplication.
+    *
+    * E the type of Expression of the matrix operand.
+    */
+    template<typename T, typename E>
+    VectorMatrixProduct<T, E>
+    mult(RowVector<T> const& left, MatrixExpression<T, E> const& right) {
+        return VectorMatrixProduct<T, E>(left, static_cast<E const&>(right));
+    }
+
+    template<typename T, typename E>
+    VectorMatrixProduct<T, E>
+    operator*(RowVector<T> const& left, MatrixExpression<T, E> const& right) {
+        return VectorMatrixProduct<T, E>(left, static_cast<E const&>(right));
+    }
+
+    /*
+    * Row vector times column vector, a 1x1 matrix.
+    */
+    template<typename T>
+    Multiplication<T, RowVector<T>, Vector<T>>
+    mult(RowVector<T> const& left, Vector<T> const& right) {
+        return Multiplication<T, RowVector<T>, Vector<T>>(left, right);
+    }
+
+    template<typename T>
+    Multiplication<T, RowVector<T>, Vector<T>>
+    operator*(RowVector<T> const& left, Vector<T> const& right) {
+        return Multiplication<T, RowVector<T>, Vector<T>>(left, right);
+    }
+
+    /*
+    * Returns the dot product of two vectors of either orientation.
+    *
+    * Throws a std::logic_error if the vectors differ in length.
+    */
+    template<typename T, Orientation O1, Orientation O2>
+    T dot(Vector<T, O1> const& x, Vector<T, O2> const& y) {
+        if (x.size() != y.size()) {
+            throw std::logic_error("The dot product is only defined for " \
+                "vectors of equal length.");
+        }
+        return detail::dot(x.data(), y.data(), x.size());
+    }
+
+    /*
+    * y += alpha * x.
+    *
+    * Throws a std::logic_error if the vectors differ in length.
+    */
+    template<typename T, Orientation O>
+    void axpy(typename detail::identity<T>::type alpha, Vector<T, O> const& x, Vector<T, O>& y) {
+        if (x.size() != y.size()) {
+            throw std::logic_error("axpy is only defined for vectors of " \
+                "equal length.");
+        }
+        detail::axpy(alpha, x.data(), y.data(), x.size());
+    }
+
+    /*
+    * Rank-1 update, a += alpha * x * trans(y).
+    *
+    * Throws a std::logic_error if a is not x.size() by y.size().
+    */
+    template<typename T, Orientation O1, Orientation O2>
+    void ger(typename detail::identity<T>::type alpha, Vector<T, O1> const& x,
+             Vector<T, O2> const& y, Matrix<T>& a) {
+        if (a.rows() != x.size() || a.cols() != y.size()) {
+            throw std::logic_error("A rank-1 update is only defined when the " \
+                "matrix has as many rows as x has elements and as many " \
+                "columns as y has elements.");
+        }
+        detail::ger(alpha, x.data(), y.data(), a.data(), a.cols(), a.rows(), a.cols());
+    }
+
+    /*
+    * Structured Matrix Base Class.
+    *
+    * Holds a compact buffer with only the entries the structure can make
+    * non-zero (or, for symmetric matrices, one copy of each mirrored pair).
+    * Derived classes describe the structure through:
+    *
+    * packed_length(m, n)    the length of the compact buffer for m x n.
+    * index(row, col)         the position of an entry in the buffer, or
+    *                         npos for an entry fixed at zero.
+    * stored_cols(row)        the range of columns of row that own a
+    *                         position in the buffer.
+    *
+    * T the value type.
+    * E the derived structured matrix type.
+    */
+    template<typename T, typename E>
+    class StructuredMatrix : public MatrixExpression<T, E> {
+        typedef T value_type;
+        typedef E expr_type;
+
+    public:
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+        StructuredMatrix(StructuredMatrix<value_type, expr_type> const&) = delete;
+        StructuredMatrix<value_type, expr_type>& operator= (StructuredMatrix<value_type, expr_type> const&) = delete;
+
+        /*
+        * Destructor.
+        */
+        ~StructuredMatrix() {
+            if (data_ != nullptr) {
+                delete[] data_;
+            }
+        }
+
+        /*
+        * Assign value as the element at the location specified by row and
+        * col, with bounds checking.
+        *
+        * Throws std::out_of_range if the location is outside the matrix or
+        * fixed at zero by its structure.
+        */
+        void set(size_t row, size_t col, value_type value) {
+            check_bounds(row, col);
+            size_t i = derived().index(row, col);
+            if (i == npos) {
+                throw std::out_of_range("Index outside of the matrix structure.");
+            }
+            data_[i] = value;
+        }
+
+        /*
+        * Returns the element at the location specified by row and col, with
+        * bounds checking.
+        */
+        value_type operator () (size_t row, size_t col) const {
+            check_bounds(row, col);
+            size_t i = derived().index(row, col);
+            return i == npos ? value_type() : data_[i];
+        }
+
+        /*
+        * Returns a pointer to the compact buffer.
+        */
+        value_type* data() {
+            return data_;
+        }
+
+        value_type const* data() const {
+            return data_;
+        }
+
+        size_t packed_size() const {
+            return length_;
+        }
+
+    protected:
+
+        StructuredMatrix() {}
+
+        expr_type const& derived() const {
+            return static_cast<expr_type const&>(*this);
+        }
+
+        /*
+        * Resizes the matrix to m x n with a zeroed compact buffer.
+        */
+        void resize_(size_t m, size_t n) {
+            size_t length = derived().packed_length(m, n);
+            if (data_ != nullptr && length_ != length) {
+                delete[] data_;
+                data_ = nullptr;
+            }
+            if (data_ == nullptr) {
+                data_ = new value_type[length];
+            }
+            length_ = length;
+            this->set_dimension(m, n);
+            std::fill_n(data_, length_, value_type());
+        }
+
+        /*
+        * Copies in matrix/matrix expression, evaluating only the entries
+        * the structure stores.
+        */
+        template<typename T2, typename E2>
+        void copy(MatrixExpression<T2, E2> const& expr) {
+            resize_(expr.rows(), expr.cols());
+            for (size_t row = 0; row < this->rows(); ++row) {
+                std::pair<size_t, size_t> range = derived().stored_cols(row);
+                for (size_t col = range.first; col < range.second; ++col) {
+                    data_[derived().index(row, col)] = static_cast<value_type>(expr(row, col));
+                }
+            }
+        }
+
+        /*
+        * Throws a std::logic_error if expr is not square.
+        */
+        template<typename T2, typename E2>
+        static void check_square(MatrixExpression<T2, E2> const& expr) {
+            if (expr.rows() != expr.cols()) {
+                throw std::logic_error("Diagonal, triangular and symmetric " \
+                    "matrices can only be constructed from square matrices.");
+            }
+        }
+
+        void check_bounds(size_t i, size_t j) const {
+            if (i >= this->rows() || j >= this->cols()) {
+                throw std::out_of_range("Index out of bounds.");
+            }
+        }
+
+    private:
+        value_type* data_ = nullptr;
+        size_t length_ = 0;
+    };
+
+    /*
+    * An NxN diagonal matrix storing only its diagonal.
+    *
+    * Multiplying by a diagonal matrix scales rows (or columns) of the other
+    * operand with one multiplication per element.
+    */
+    template<typename T>
+    class DiagonalMatrix : public StructuredMatrix<T, DiagonalMatrix<T>> {
+        typedef T value_type;
+        typedef StructuredMatrix<T, DiagonalMatrix<T>> base_type;
+
+    public:
+
+        DiagonalMatrix() {
+            this->resize_(0, 0);
+        }
+
+        explicit DiagonalMatrix(size_t n) {
+            this->resize_(n, n);
+        }
+
+        DiagonalMatrix(DiagonalMatrix<value_type> const& orig) : base_type() {
+            this->copy(orig);
+        }
+
+        /*
+        * Constructs from the diagonal of a square matrix expression.
+        */
+        template<typename E>
+        DiagonalMatrix(MatrixExpression<value_type, E> const& expr) {
+            this->check_square(expr);
+            this->copy(expr);
+        }
+
+        /*
+        * Constructs from the list of diagonal values.
+        */
+        template<typename T2>
+        DiagonalMatrix(const std::initializer_list<T2> list) {
+            this->resize_(list.size(), list.size());
+            std::transform(list.begin(), list.end(), this->data(), [](T2 element) {
+                return static_cast<value_type>(element);
+            });
+        }
+
+        DiagonalMatrix<value_type>& operator= (DiagonalMatrix<value_type> const& orig) {
+            if (&orig != this) {
+                this->copy(orig);
+            }
+            return *this;
+        }
+
+        // structure
+
+        size_t packed_length(size_t rows, size_t) const {
+            return rows;
+        }
+
+        size_t index(size_t row, size_t col) const {
+            return row == col ? row : base_type::npos;
+        }
+
+        std::pair<size_t, size_t> stored_cols(size_t row) const {
+            return std::make_pair(row, row + 1);
+        }
+
+        std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+            return std::make_pair(row, row + 1);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+            return std::make_pair(col, col + 1);
+        }
+    };
+
+    template<typename T>
+    struct operand_traits<DiagonalMatrix<T>> {
+        typedef DiagonalMatrix<T> const& type;
+    };
+
+    /*
+    * Triangle of a TriangularMatrix holding its non-zero entries.
+    */
+    enum class Triangle { upper, lower };
+
+    /*
+    * An NxN triangular matrix in packed row-major storage.
+    *
+    * Products with a triangular operand only visit its triangle, for half
+    * the multiplications of a dense product.
+    *
+    * T the value type.
+    * U the triangle holding the non-zero entries.
+    */
+    template<typename T, Triangle U = Triangle::upper>
+    class TriangularMatrix : public StructuredMatrix<T, TriangularMatrix<T, U>> {
+        typedef T value_type;
+        typedef StructuredMatrix<T, TriangularMatrix<T, U>> base_type;
+
+    public:
+
+        TriangularMatrix() {
+            this->resize_(0, 0);
+        }
+
+        explicit TriangularMatrix(size_t n) {
+            this->resize_(n, n);
+        }
+
+        TriangularMatrix(TriangularMatrix<value_type, U> const& orig) : base_type() {
+            this->copy(orig);
+        }
+
+        /*
+        * Constructs from the triangle of a square matrix expression; the
+        * other triangle is not evaluated.
+        */
+        template<typename E>
+        TriangularMatrix(MatrixExpression<value_type, E> const& expr) {
+            this->check_square(expr);
+            this->copy(expr);
+        }
+
+        /*
+        * Initializer list constructor. Entries outside the triangle are
+        * ignored.
+        */
+        template<typename T2>
+        TriangularMatrix(const std::initializer_list<std::initializer_list<T2>> list) {
+            Matrix<value_type> dense(list);
+            this->check_square(dense);
+            this->copy(dense);
+        }
+
+        TriangularMatrix<value_type, U>& operator= (TriangularMatrix<value_type, U> const& orig) {
+            if (&orig != this) {
+                this->copy(orig);
+            }
+            return *this;
+        }
+
+        // structure
+
+        size_t packed_length(size_t rows, size_t) const {
+            return rows * (rows + 1) / 2;
+        }
+
+        size_t index(size_t row, size_t col) const {
+            if (U == Triangle::upper) {
+                return col < row ? base_type::npos : row * this->cols() - row * (row - 1) / 2 + col - row;
+            }
+            return col > row ? base_type::npos : row * (row + 1) / 2 + col;
+        }
+
+        std::pair<size_t, size_t> stored_cols(size_t row) const {
+            return nonzero_cols_(row);
+        }
+
+        std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+            return U == Triangle::upper ? std::make_pair(row, this->cols())
+                                        : std::make_pair(size_t(0), row + 1);
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+            return U == Triangle::upper ? std::make_pair(size_t(0), col + 1)
+                                        : std::make_pair(col, this->rows());
+        }
+    };
+
+    template<typename T, Triangle U>
+    struct operand_traits<TriangularMatrix<T, U>> {
+        typedef TriangularMatrix<T, U> const& type;
+    };
+
+    /*
+    * An NxN symmetric matrix storing its lower triangle packed row-major.
+    *
+    * Constructing one from an expression evaluates only the lower triangle,
+    * so a symmetric rank-k update such as
+    *
+    *     SymmetricMatrix<double> c = c0 + a * trans(a);
+    *
+    * computes n(n+1)/2 entries instead of n^2.
+    */
+    template<typename T>
+    class SymmetricMatrix : public StructuredMatrix<T, SymmetricMatrix<T>> {
+        typedef T value_type;
+        typedef StructuredMatrix<T, SymmetricMatrix<T>> base_type;
+
+    public:
+
+        SymmetricMatrix() {
+            this->resize_(0, 0);
+        }
+
+        explicit SymmetricMatrix(size_t n) {
+            this->resize_(n, n);
+        }
+
+        SymmetricMatrix(SymmetricMatrix<value_type> const& orig) : base_type() {
+            this->copy(orig);
+        }
+
+        /*
+        * Constructs from the lower triangle of a square matrix expression,
+        * which is assumed to be symmetric; the upper triangle is not
+        * evaluated.
+        */
+        template<typename E>
+        SymmetricMatrix(MatrixExpression<value_type, E> const& expr) {
+            this->check_square(expr);
+            this->copy(expr);
+        }
+
+        /*
+        * Initializer list constructor. Only the lower triangle is read.
+        */
+        template<typename T2>
+        SymmetricMatrix(const std::initializer_list<std::initializer_list<T2>> list) {
+            Matrix<value_type> dense(list);
+            this->check_square(dense);
+            this->copy(dense);
+        }
+
+        SymmetricMatrix<value_type>& operator= (SymmetricMatrix<value_type> const& orig) {
+            if (&orig != this) {
+                this->copy(orig);
+            }
+            return *this;
+        }
+
+        // structure
+
+        size_t packed_length(size_t rows, size_t) const {
+            return rows * (rows + 1) / 2;
+        }
+
+        size_t index(size_t row, size_t col) const {
+            return col > row ? col * (col + 1) / 2 + row : row * (row + 1) / 2 + col;
+        }
+
+        std::pair<size_t, size_t> stored_cols(size_t row) const {
+            return std::make_pair(size_t(0), row + 1);
+        }
+    };
+
+    template<typename T>
+    struct operand_traits<SymmetricMatrix<T>> {
+        typedef SymmetricMatrix<T> const& type;
+    };
+
+    /*
+    * An MxN band matrix with lower sub-diagonals and upper super-diagonals,
+    * stored row by row with lower + upper + 1 slots per row.
+    *
+    * Products with a band operand only visit its band.
+    */
+    template<typename T>
+    class BandMatrix : public StructuredMatrix<T, BandMatrix<T>> {
+        typedef T value_type;
+        typedef StructuredMatrix<T, BandMatrix<T>> base_type;
+
+    public:
+
+        BandMatrix() {
+            this->resize_(0, 0);
+        }
+
+        /*
+        * Standard constructor.
+        *
+        * lower the number of non-zero diagonals below the main diagonal.
+        * upper the number of non-zero diagonals above the main diagonal.
+        */
+        BandMatrix(size_t rows, size_t cols, size_t lower, size_t upper)
+        : lower_(lower), upper_(upper) {
+            this->resize_(rows, cols);
+        }
+
+        BandMatrix(BandMatrix<value_type> const& orig)
+        : base_type(), lower_(orig.lower_), upper_(orig.upper_) {
+            this->copy(orig);
+        }
+
+        /*
+        * Constructs from the band of a matrix expression; entries outside
+        * the band are not evaluated.
+        */
+        template<typename E>
+        BandMatrix(MatrixExpression<value_type, E> const& expr, size_t lower, size_t upper)
+        : lower_(lower), upper_(upper) {
+            this->copy(expr);
+        }
+
+        BandMatrix<value_type>& operator= (BandMatrix<value_type> const& orig) {
+            if (&orig != this) {
+                lower_ = orig.lower_;
+                upper_ = orig.upper_;
+                this->copy(orig);
+            }
+            return *this;
+        }
+
+        size_t lower() const {
+            return lower_;
+        }
+
+        size_t upper() const {
+            return upper_;
+        }
+
+        // structure
+
+        size_t packed_length(size_t rows, size_t) const {
+            return rows * (lower_ + upper_ + 1);
+        }
+
+        size_t index(size_t row, size_t col) const {
+            if (col + lower_ < row || col > row + upper_) {
+                return base_type::npos;
+            }
+            return row * (lower_ + upper_ + 1) + col + lower_ - row;
+        }
+
+        std::pair<size_t, size_t> stored_cols(size_t row) const {
+            return nonzero_cols_(row);
+        }
+
+        std::pair<size_t, size_t> nonzero_cols_(size_t row) const {
+            return std::make_pair(row > lower_ ? row - lower_ : 0,
+                                  std::min(this->cols(), row + upper_ + 1));
+        }
+
+        std::pair<size_t, size_t> nonzero_rows_(size_t col) const {
+            return std::make_pair(col > upper_ ? col - upper_ : 0,
+                                  std::min(this->rows(), col + lower_ + 1));
+        }
+
+    private:
+        size_t lower_ = 0;
+        size_t upper_ = 0;
+    };
+
+    template<typename T>
+    struct operand_traits<BandMatrix<T>> {
+        typedef BandMatrix<T> const& type;
+    };
+
+    namespace detail {
+
+        /*
+        * Evaluates a square matrix expression into the n x n buffer out.
+        *
+        * Throws a std::logic_error if the expression is not square.
+        */
+        template<typename T, typename E>
+        void evaluate_square(MatrixExpression<T, E> const& expr, T* out) {
+            if (expr.rows() != expr.cols()) {
+                throw std::logic_error("Matrix powers and polynomials are " \
+                    "only defined for square matrices.");
+            }
+            size_t n = expr.rows();
+            for (size_t row = 0; row < n; ++row) {
+                for (size_t col = 0; col < n; ++col) {
+                    out[row * n + col] = expr(row, col);
+                }
+            }
+        }
+
+        /*
+        * Sets the n x n buffer out to alpha times the identity.
+        */
+        template<typename T>
+        void set_identity(T alpha, T* out, size_t n) {
+            std::fill_n(out, n * n, T());
+            for (size_t i = 0; i < n; ++i) {
+                out[i * n + i] = alpha;
+            }
+        }
+    }
+
+    /*
+    * Returns expr raised to the power k; the identity for k = 0.
+    *
+    * Uses left-to-right binary exponentiation, floor(log2 k) squarings plus
+    * one product per further set bit of k, ping-ponging between two
+    * preallocated buffers: three allocations in all, independent of k.
+    *
+    * Throws a std::logic_error if expr is not square.
+    *
+    * E the type of Expression of the operand.
+    */
+    template<typename T, typename E>
+    Matrix<T> pow(MatrixExpression<T, E> const& expr, size_t k) {
+        size_t n = expr.rows();
+        Matrix<T> a(n, expr.cols(), Placement::local);
+        detail::evaluate_square(expr, a.data());
+        Matrix<T> result(n, n, Placement::local);
+        if (k == 0) {
+            detail::set_identity(T(1), result.data(), n);
+            return result;
+        }
+        Matrix<T> scratch(n, n, Placement::local);
+        T const* base = static_cast<Matrix<T> const&>(a).data();
+        std::copy(base, base + n * n, result.data());
+
+        size_t bit = 0;
+        while (k >> (bit + 1)) {
+            ++bit;
+        }
+        while (bit-- > 0) {
+            detail::gemm(result.data(), n, false, result.data(), n, false, scratch.data(), n, n, n);
+            result.swap(scratch);
+            if ((k >> bit) & 1) {
+                detail::gemm(result.data(), n, false, base, n, false, scratch.data(), n, n, n);
+                result.swap(scratch);
+            }
+        }
+        return result;
+    }
+
+    /*
+    * Evaluates the matrix polynomial
+    *
+    *     coeffs[0] * A^d + coeffs[1] * A^(d-1) + ... + coeffs[d] * I
+    *
+    * where A is expr and d = coeffs.size() - 1; coefficients are given
+    * highest degree first, as for polyval in NumPy and MATLAB.
+    *
+    * Uses the Paterson-Stockmeyer scheme: A^1..A^s, s ~ sqrt(d), are kept in
+    * one block and the polynomial is evaluated by Horner's rule in A^s, for
+    * about 2 sqrt(d) products instead of d. The powers block and two
+    * ping-pong buffers are the only allocations, independent of d.
+    *
+    * Throws a std::logic_error if expr is not square.
+    *
+    * E the type of Expression of the operand.
+    */
+    template<typename T, typename E>
+    Matrix<T> polyval(std::vector<typename detail::identity<T>::type> const& coeffs,
+                      MatrixExpression<T, E> const& expr) {
+        size_t n = expr.rows();
+        size_t degree = coeffs.empty() ? 0 : coeffs.size() - 1;
+        size_t s = 1;
+        while ((s + 1) * (s + 1) <= degree) {
+            ++s;
+        }
+        size_t block = n * n;
+        // coefficient of A^i
+        auto coeff = [&coeffs, degree](size_t i) {
+            return i <= degree && !coeffs.empty() ? coeffs[degree - i] : T();
+        };
+
+        // powers holds A^(i + 1) in block i
+        Matrix<T> powers(s * n, expr.cols(), Placement::local);
+        detail::evaluate_square(expr, powers.data());
+        T* power = powers.data();
+        for (size_t i = 1; i < s; ++i) {
+            detail::gemm(power + (i - 1) * block, n, false, power, n, false, power + i * block, n, n, n);
+        }
+
+        // out += sum of coeff(j * s + i) * A^i for i < s
+        auto add_chunk = [&](size_t j, T* out) {
+            for (size_t i = 0; i < s; ++i) {
+                T c = coeff(j * s + i);
+                if (c == T()) {
+                    continue;
+                }
+                if (i == 0) {
+                    for (size_t r = 0; r < n; ++r) {
+                        out[r * n + r] += c;
+                    }
+                } else {
+                    detail::axpy(c, power + (i - 1) * block, out, block);
+                }
+            }
+        };
+
+        Matrix<T> result(n, n, Placement::local);
+        Matrix<T> scratch(n, n, Placement::local);
+        T const* top = power + (s - 1) * block;
+        size_t j = degree / s;
+        if (j > 0 && degree % s == 0) {
+            // the leading chunk is a single coefficient: c * A^s needs no product
+            detail::axpy(coeff(degree), top, result.data(), block);
+            --j;
+        }
+        add_chunk(j, result.data());
+        while (j-- > 0) {
+            detail::gemm(result.data(), n, false, top, n, false, scratch.data(), n, n, n);
+            add_chunk(j, scratch.data());
+            result.swap(scratch);
+        }
+        return result;
     }
 }
\ No newline at end of file